@@ -0,0 +1,516 @@
+#include "TSConfigLoader.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TSConfigLoaderSSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+TSDictionary<TSType *, TSConfigLoader::ParseFunction>* TSConfigLoader::parsers = NULL;
+
+/////////////////////////////////////////////////////////////////////////
+// Scanning
+/////////////////////////////////////////////////////////////////////////
+
+// First a or b in [text, end), 16 bytes at a time where SSE2 is available
+static const char* FindEither(const char* text, const char* end, char a, char b)
+{
+#ifdef TSConfigLoaderSSE2
+    const __m128i first = _mm_set1_epi8(a);
+    const __m128i second = _mm_set1_epi8(b);
+    
+    for(; end - text >= 16; text += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)text);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, first), _mm_cmpeq_epi8(chunk, second)));
+        
+        if(mask)
+        {
+#ifdef _MSC_VER
+            unsigned long offset;
+            _BitScanForward(&offset, mask);
+            return text + offset;
+#else
+            return text + __builtin_ctz(mask);
+#endif
+        }
+    }
+#endif
+    
+    for(; text != end; text++)
+    {
+        if(*text == a || *text == b)
+        {
+            return text;
+        }
+    }
+    
+    return end;
+}
+
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void Trim(const char*& text, const char*& end)
+{
+    while(text != end && IsSpace(*text)) text++;
+    while(end != text && IsSpace(end[-1])) end--;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Built in parsers
+/////////////////////////////////////////////////////////////////////////
+static bool ParseString(void* value, const char* text, size_t length)
+{
+    ((TSString *)value)->assign(text, length);
+    return true;
+}
+
+void TSConfigLoader::addParser(TSType* type, ParseFunction parse)
+{
+    if(!parsers)
+    {
+        parsers = new TSDictionary<TSType *, ParseFunction>;
+    }
+    
+    (*parsers)[type] = parse;
+}
+
+TSConfigLoader::ParseFunction TSConfigLoader::findParser(TSType* type)
+{
+    for(TSType* currentType = type; currentType; currentType = currentType->base())
+    {
+        if(parsers)
+        {
+            TSDictionary<TSType *, ParseFunction>::iterator it = parsers->find(currentType);
+            if(it != parsers->end())
+            {
+                return it->second;
+            }
+        }
+        
+        if(currentType == TSStringType)
+        {
+            return ParseString;
+        }
+    }
+    
+    return NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// TSConfigLoader
+/////////////////////////////////////////////////////////////////////////
+TSConfigLoader::TSConfigLoader(TSType* type, void* object) : maxGrowth(16), type(type), object(object), lineNumber(0)
+{
+    section.type = type;
+    section.value = object;
+}
+
+bool TSConfigLoader::load(const char* fileName)
+{
+#ifdef _WIN32
+    FILE* file = fopen(fileName, "rb");
+    if(!file)
+    {
+        return false;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    TSString text(size > 0 ? size : 0, '\0');
+    bool read = size <= 0 || fread(&text[0], 1, size, file) == (size_t)size;
+    fclose(file);
+    
+    if(read)
+    {
+        load(text.data(), text.size());
+    }
+    return read;
+#else
+    int file = open(fileName, O_RDONLY);
+    if(file < 0)
+    {
+        return false;
+    }
+    
+    struct stat status;
+    if(fstat(file, &status) != 0)
+    {
+        close(file);
+        return false;
+    }
+    
+    size_t size = (size_t)status.st_size;
+    if(size == 0)
+    {
+        close(file);
+        load("", 0);
+        return true;
+    }
+    
+    void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    
+    if(mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    load((const char *)mapped, size);
+    munmap(mapped, size);
+    return true;
+#endif
+}
+
+void TSConfigLoader::load(const char* text, size_t length)
+{
+    section.type = type;
+    section.value = object;
+    lineNumber = 0;
+    assigned.clear();
+    sectionPath.clear();
+    errorLines.clear();
+    
+    const char* end = text + length;
+    for(const char* line = text; line != end; )
+    {
+        lineNumber++;
+        
+        // One pass finds the delimiter or the end of a line without one
+        const char* delimiter = FindEither(line, end, '=', '\n');
+        const char* lineEnd = delimiter;
+        
+        if(delimiter != end && *delimiter == '=')
+        {
+            lineEnd = FindEither(delimiter + 1, end, '\n', '\n');
+        }
+        else
+        {
+            delimiter = NULL;
+        }
+        
+        loadLine(line, lineEnd, delimiter);
+        
+        line = lineEnd == end ? end : lineEnd + 1;
+    }
+    
+    std::sort(assigned.begin(), assigned.end());
+    assigned.erase(std::unique(assigned.begin(), assigned.end()), assigned.end());
+    setDefaults(type, object);
+}
+
+void TSConfigLoader::loadLine(const char* line, const char* lineEnd, const char* delimiter)
+{
+    const char* text = line;
+    const char* textEnd = delimiter ? delimiter : lineEnd;
+    Trim(text, textEnd);
+    
+    if(text == textEnd && !delimiter)
+    {
+        return;
+    }
+    
+    if(text != textEnd && (*text == '#' || *text == ';'))
+    {
+        return;
+    }
+    
+    // [section] resolves the keys that follow relative to section
+    if(!delimiter && *text == '[' && textEnd[-1] == ']')
+    {
+        section.type = type;
+        section.value = object;
+        path.clear();
+        
+        if(!resolve(section, text + 1, textEnd - 1))
+        {
+            section.type = NULL;
+            path.clear();
+            errorLines.push_back(lineNumber);
+        }
+        
+        sectionPath.swap(path);
+        return;
+    }
+    
+    if(!delimiter)
+    {
+        errorLines.push_back(lineNumber);
+        return;
+    }
+    
+    const char* value = delimiter + 1;
+    const char* valueEnd = lineEnd;
+    Trim(value, valueEnd);
+    
+    if(valueEnd - value >= 2 && *value == '"' && valueEnd[-1] == '"')
+    {
+        value++;
+        valueEnd--;
+    }
+    
+    Target target = section;
+    path.clear();
+    ParseFunction parse = resolve(target, text, textEnd) ? findParser(target.type) : NULL;
+    
+    // A bad value leaves the field unassigned so it still gets its default
+    if(!parse || !parse(target.value, value, valueEnd - value))
+    {
+        errorLines.push_back(lineNumber);
+        return;
+    }
+    
+    record(sectionPath);
+    record(path);
+}
+
+void TSConfigLoader::record(const TSArray<Assignment>& fields)
+{
+    // Consecutive keys under the same field are recorded once
+    size_t size = fields.size();
+    for(size_t i = 0; i < size; i++)
+    {
+        if(assigned.empty() || !(assigned.back() == fields[i]))
+        {
+            assigned.push_back(fields[i]);
+        }
+    }
+}
+
+bool TSConfigLoader::resolve(Target& target, const char* key, const char* keyEnd)
+{
+    const char* name = key;
+    
+    while(name != keyEnd)
+    {
+        const char* nameEnd = name;
+        while(nameEnd != keyEnd && *nameEnd != '.' && *nameEnd != '[') nameEnd++;
+        
+        if(nameEnd != name && !step(target, name, nameEnd))
+        {
+            return false;
+        }
+        
+        while(nameEnd != keyEnd && *nameEnd == '[')
+        {
+            const char* indexEnd = nameEnd + 1;
+            while(indexEnd != keyEnd && *indexEnd != ']') indexEnd++;
+            
+            if(indexEnd == keyEnd || !index(target, nameEnd + 1, indexEnd))
+            {
+                return false;
+            }
+            
+            nameEnd = indexEnd + 1;
+        }
+        
+        if(nameEnd != keyEnd && *nameEnd != '.')
+        {
+            return false;
+        }
+        
+        name = nameEnd == keyEnd ? keyEnd : nameEnd + 1;
+    }
+    
+    return target.type != NULL;
+}
+
+bool TSConfigLoader::step(Target& target, const char* name, const char* nameEnd)
+{
+    resolveValue(target);
+    if(!target.type)
+    {
+        return false;
+    }
+    
+    TSType* field = target.type->getFieldByDescription(name, nameEnd - name);
+    void* value = field ? field->get(target.value) : NULL;
+    if(!value)
+    {
+        return false;
+    }
+    
+    Assignment assignment;
+    assignment.owner = target.value;
+    assignment.field = field;
+    path.push_back(assignment);
+    
+    target.type = field->base();
+    target.value = value;
+    return true;
+}
+
+bool TSConfigLoader::index(Target& target, const char* index, const char* indexEnd)
+{
+    resolveValue(target);
+    if(!target.type)
+    {
+        return false;
+    }
+    
+    DictionaryTypeClass* dictionaryType = DictionaryType->cast(target.type);
+    if(dictionaryType)
+    {
+        TSString key(index, indexEnd - index);
+        void* value = dictionaryType->find(target.value, key);
+        if(!value)
+        {
+            value = dictionaryType->insert(target.value, key);
+            setNewDefaults(dictionaryType->memberType(), value);
+        }
+        
+        target.value = value;
+        target.type = dictionaryType->memberType();
+        return true;
+    }
+    
+    if(index == indexEnd)
+    {
+        return false;
+    }
+    
+    int position = 0;
+    for(const char* digit = index; digit != indexEnd; digit++)
+    {
+        if(*digit < '0' || *digit > '9' || position > 100000000)
+        {
+            return false;
+        }
+        position = position * 10 + (*digit - '0');
+    }
+    
+    ArrayTypeClass* arrayType = ArrayType->cast(target.type);
+    if(arrayType)
+    {
+        int count = arrayType->count(target.value);
+        if(position >= count + maxGrowth)
+        {
+            return false;
+        }
+        
+        if(position >= count && !arrayType->resize(target.value, position + 1))
+        {
+            return false;
+        }
+        
+        for(int i = count; i <= position; i++)
+        {
+            setNewDefaults(arrayType->memberType(), arrayType->childAtIndex(target.value, i));
+        }
+        
+        target.value = arrayType->childAtIndex(target.value, position);
+        target.type = arrayType->memberType();
+        return true;
+    }
+    
+    DequeTypeClass* dequeType = DequeType->cast(target.type);
+    if(dequeType)
+    {
+        int count = dequeType->count(target.value);
+        if(position >= count + maxGrowth)
+        {
+            return false;
+        }
+        
+        if(position >= count && !dequeType->resize(target.value, position + 1))
+        {
+            return false;
+        }
+        
+        for(int i = count; i <= position; i++)
+        {
+            setNewDefaults(dequeType->memberType(), dequeType->childAtIndex(target.value, i));
+        }
+        
+        target.value = dequeType->childAtIndex(target.value, position);
+        target.type = dequeType->memberType();
+        return true;
+    }
+    
+    return false;
+}
+
+void TSConfigLoader::resolveValue(Target& target)
+{
+    if(!target.type)
+    {
+        return;
+    }
+    
+    // Keys only reach through pointers, values aren't assigned to them
+    if(target.type->is(PointerType))
+    {
+        target.value = *(void **)target.value;
+        target.type = target.value ? PointerType->cast(target.type)->dereferenced() : NULL;
+    }
+    
+    if(target.value && target.type && target.type->is(TSObjectType))
+    {
+        target.type = ((TSObject *)target.value)->type;
+    }
+}
+
+void TSConfigLoader::setDefaults(TSType* type, void* object)
+{
+    if(type->is(TSObjectType))
+    {
+        type = ((TSObject *)object)->type;
+    }
+    
+    // The object's own type field is never a setting
+    for(TSType* currentType = type; currentType && currentType != TSObjectType; currentType = currentType->base())
+    {
+        const TSArray<TSType *>& fields = currentType->fields;
+        size_t size = fields.size();
+        for(size_t i = 0; i < size; i++)
+        {
+            TSType* field = fields[i];
+            
+            Assignment assignment;
+            assignment.owner = object;
+            assignment.field = field;
+            
+            if(!std::binary_search(assigned.begin(), assigned.end(), assignment))
+            {
+                field->setDefaultValue(object);
+            }
+            else if(!field->is(PointerType))
+            {
+                setDefaults(field->base(), field->get(object));
+            }
+        }
+    }
+}
+
+void TSConfigLoader::setNewDefaults(TSType* type, void* object)
+{
+    // Elements added by a key have no values yet, fields the file doesn't
+    // set afterwards keep these
+    for(TSType* currentType = type; currentType && currentType != TSObjectType; currentType = currentType->base())
+    {
+        const TSArray<TSType *>& fields = currentType->fields;
+        size_t size = fields.size();
+        for(size_t i = 0; i < size; i++)
+        {
+            fields[i]->setDefaultValue(object);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////////////////
+// TSConfigLoader
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TSConfigLoader_h
+#define TSConfigLoader_h
+
+#include "TSType.h"
+
+/////////////////////////////////////////////////////////////////////////
+// Loads "section.field = value" text into a reflected object.
+//
+//     # comment
+//     fileName = user.prefs
+//     window.title = "Main"
+//     names[0] = Bob
+//     [window]
+//     font = Courier
+//
+// Values are parsed in place and written straight into the fields,
+// fields without a value get their default value afterwards.
+/////////////////////////////////////////////////////////////////////////
+class TSConfigLoader
+{
+public:
+    // Stores text in value, false if text is not a valid value
+    typedef bool (*ParseFunction)(void* value, const char* text, size_t length);
+    
+    // Global to all loaders
+    static void addParser(TSType* type, ParseFunction parse);
+    static ParseFunction findParser(TSType* type);
+    
+    TSConfigLoader(TSType* type, void* object);
+    
+    // Maps the file into memory, false if it can't be read
+    bool load(const char* fileName);
+    void load(const char* text, size_t length);
+    
+    // Lines with unknown keys or bad values
+    TSArray<int> errorLines;
+    
+    // How far past the end of an array or deque an index may reach, the
+    // elements in between are added. Lines reaching further are errors.
+    int maxGrowth;
+
+private:
+    class Target
+    {
+    public:
+        TSType* type;
+        void* value;
+    };
+    
+    class Assignment
+    {
+    public:
+        void* owner;
+        TSType* field;
+        
+        bool operator<(const Assignment& other) const
+        {
+            return owner < other.owner || (owner == other.owner && field < other.field);
+        }
+        
+        bool operator==(const Assignment& other) const
+        {
+            return owner == other.owner && field == other.field;
+        }
+    };
+    
+    bool resolve(Target& target, const char* key, const char* keyEnd);
+    bool step(Target& target, const char* name, const char* nameEnd);
+    bool index(Target& target, const char* index, const char* indexEnd);
+    void resolveValue(Target& target);
+    
+    void loadLine(const char* line, const char* lineEnd, const char* delimiter);
+    void record(const TSArray<Assignment>& fields);
+    void setDefaults(TSType* type, void* object);
+    void setNewDefaults(TSType* type, void* object);
+    
+    TSType* type;
+    void* object;
+    Target section;
+    int lineNumber;
+    
+    // Fields that were set, including the ones leading to them
+    TSArray<Assignment> assigned;
+    
+    // Fields leading to the section and to the current key, only
+    // recorded once the key's value is parsed
+    TSArray<Assignment> sectionPath;
+    TSArray<Assignment> path;
+    
+    static TSDictionary<TSType *, ParseFunction>* parsers;
+};
+
+#endif
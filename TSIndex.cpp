@@ -0,0 +1,327 @@
+#include "TSIndex.h"
+
+TSDictionary<TSType *, TSIndexKey>* TSIndexKey::keys = NULL;
+
+/////////////////////////////////////////////////////////////////////////
+// Built in keys
+/////////////////////////////////////////////////////////////////////////
+static size_t HashString(const void* value)
+{
+    return std::hash<TSString>()(*(const TSString *)value);
+}
+
+static bool LessString(const void* value, const void* otherValue)
+{
+    return *(const TSString *)value < *(const TSString *)otherValue;
+}
+
+static size_t HashPointer(const void* value)
+{
+    return std::hash<const void *>()(*(const void * const *)value);
+}
+
+static bool LessPointer(const void* value, const void* otherValue)
+{
+    return std::less<const void *>()(*(const void * const *)value, *(const void * const *)otherValue);
+}
+
+static const TSIndexKey StringKey = { HashString, LessString };
+static const TSIndexKey PointerKey = { HashPointer, LessPointer };
+
+/////////////////////////////////////////////////////////////////////////
+// TSIndexKey
+/////////////////////////////////////////////////////////////////////////
+void TSIndexKey::add(TSType* type, HashFunction hash, LessFunction less)
+{
+    if(!keys)
+    {
+        keys = new TSDictionary<TSType *, TSIndexKey>;
+    }
+    
+    TSIndexKey& key = (*keys)[type];
+    key.hash = hash;
+    key.less = less;
+}
+
+const TSIndexKey* TSIndexKey::find(TSType* type)
+{
+    for(TSType* currentType = type; currentType; currentType = currentType->base())
+    {
+        if(keys)
+        {
+            TSDictionary<TSType *, TSIndexKey>::iterator it = keys->find(currentType);
+            if(it != keys->end())
+            {
+                return &it->second;
+            }
+        }
+        
+        if(currentType == TSStringType)
+        {
+            return &StringKey;
+        }
+        
+        if(currentType == PointerType)
+        {
+            return &PointerKey;
+        }
+    }
+    
+    return NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// TSIndex
+/////////////////////////////////////////////////////////////////////////
+TSIndex::TSIndex(TSType* elementType, TSType* field, Kind kind) :
+    elementType(elementType), typedElements(elementType->is(TSObjectType)), field(field), kind(kind),
+    key(NULL), hashed(NULL), sorted(NULL), elementCount(0)
+{
+    key = field ? TSIndexKey::find(field->base()) : NULL;
+    assert((!field || key) && "The indexed field's type needs a TSIndexKey\n");
+    
+    if(key && kind == Hash)
+    {
+        hashed = new HashedElements(0, Hasher(key), Equal(key));
+    }
+    else if(key)
+    {
+        sorted = new SortedElements(Less(key));
+    }
+}
+
+TSIndex::~TSIndex()
+{
+    clear();
+    delete hashed;
+    delete sorted;
+}
+
+void TSIndex::build(ArrayTypeClass* arrayType, void* array)
+{
+    clear();
+    
+    bool pointers = arrayType->memberType()->is(PointerType);
+    
+    int size = arrayType->count(array);
+    entries.reserve(size);
+    if(hashed)
+    {
+        hashed->reserve(size);
+    }
+    
+    for(int i = 0; i < size; i++)
+    {
+        void* element = arrayType->childAtIndex(array, i);
+        if(pointers)
+        {
+            element = *(void **)element;
+        }
+        
+        if(element)
+        {
+            add(element);
+        }
+    }
+}
+
+void TSIndex::clear()
+{
+    if(hashed)
+    {
+        for(HashedElements::iterator it = hashed->begin(); it != hashed->end(); it++)
+        {
+            delete it->second;
+        }
+        hashed->clear();
+    }
+    if(sorted) sorted->clear();
+    elementsByType.clear();
+    entries.clear();
+    elementCount = 0;
+}
+
+void TSIndex::add(void* element)
+{
+    assert(!entries.count(element) && "Element is already in the index\n");
+    
+    TSArray<void *>& elements = elementsByType[typeOf(element)];
+    
+    Entry& entry = entries[element];
+    entry.position = elements.size();
+    entry.group = NULL;
+    entry.groupPosition = 0;
+    entry.sortedEntry = sorted ? sorted->end() : SortedElements::iterator();
+    elements.push_back(element);
+    elementCount++;
+    
+    const void* value = field ? field->get(element) : NULL;
+    if(!value)
+    {
+        return;
+    }
+    
+    if(hashed)
+    {
+        HashedElements::iterator found = hashed->find(&value);
+        if(found != hashed->end())
+        {
+            entry.group = found->second;
+        }
+        else
+        {
+            entry.group = new Group;
+            entry.group->value = value;
+            hashed->insert(HashedElements::value_type(&entry.group->value, entry.group));
+        }
+        
+        entry.groupPosition = entry.group->elements.size();
+        entry.group->elements.push_back(element);
+    }
+    else
+    {
+        entry.sortedEntry = sorted->insert(SortedElements::value_type(value, element));
+    }
+}
+
+void TSIndex::remove(void* element)
+{
+    TSDictionary<void *, Entry>::iterator found = entries.find(element);
+    if(found == entries.end())
+    {
+        return;
+    }
+    
+    Entry entry = found->second;
+    entries.erase(found);
+    
+    // Order doesn't matter, the last element takes the removed one's place
+    TSDictionary<TSType *, TSArray<void *> >::iterator byType = elementsByType.find(typeOf(element));
+    TSArray<void *>& elements = byType->second;
+    void* moved = elements.back();
+    elements[entry.position] = moved;
+    elements.pop_back();
+    elementCount--;
+    
+    if(moved != element)
+    {
+        entries[moved].position = entry.position;
+    }
+    
+    // findByType only checks the types that are present
+    if(elements.empty())
+    {
+        elementsByType.erase(byType);
+    }
+    
+    if(entry.group)
+    {
+        Group* group = entry.group;
+        moved = group->elements.back();
+        group->elements[entry.groupPosition] = moved;
+        group->elements.pop_back();
+        
+        if(moved != element)
+        {
+            entries[moved].groupPosition = entry.groupPosition;
+        }
+        
+        if(group->elements.empty())
+        {
+            hashed->erase(&group->value);
+            delete group;
+        }
+        else if(group->value == field->get(element))
+        {
+            // The value may not outlive element, any other member's is equal
+            group->value = field->get(group->elements[0]);
+        }
+    }
+    else if(sorted && entry.sortedEntry != sorted->end())
+    {
+        sorted->erase(entry.sortedEntry);
+    }
+}
+
+void TSIndex::findEqual(const void* key, TSArray<void *>& results, TSType* type)
+{
+    TypeFilter filter(type);
+    
+    if(hashed)
+    {
+        HashedElements::iterator found = hashed->find(&key);
+        if(found == hashed->end())
+        {
+            return;
+        }
+        
+        const TSArray<void *>& elements = found->second->elements;
+        size_t size = elements.size();
+        for(size_t i = 0; i < size; i++)
+        {
+            if(filter.matches(typeOf(elements[i]))) results.push_back(elements[i]);
+        }
+    }
+    else if(sorted)
+    {
+        std::pair<SortedElements::iterator, SortedElements::iterator> range = sorted->equal_range(key);
+        for(SortedElements::iterator it = range.first; it != range.second; it++)
+        {
+            if(filter.matches(typeOf(it->second))) results.push_back(it->second);
+        }
+    }
+}
+
+void TSIndex::findRange(const void* low, const void* high, TSArray<void *>& results, TSType* type)
+{
+    TypeFilter filter(type);
+    
+    // Hashed indexes have no order to walk, every distinct value is checked
+    if(hashed)
+    {
+        for(HashedElements::iterator it = hashed->begin(); it != hashed->end(); it++)
+        {
+            const void* value = it->second->value;
+            if(key->less(value, low) || key->less(high, value))
+            {
+                continue;
+            }
+            
+            const TSArray<void *>& elements = it->second->elements;
+            size_t size = elements.size();
+            for(size_t i = 0; i < size; i++)
+            {
+                if(filter.matches(typeOf(elements[i]))) results.push_back(elements[i]);
+            }
+        }
+        return;
+    }
+    
+    if(!sorted)
+    {
+        return;
+    }
+    
+    SortedElements::iterator end = sorted->upper_bound(high);
+    for(SortedElements::iterator it = sorted->lower_bound(low); it != end; it++)
+    {
+        if(filter.matches(typeOf(it->second))) results.push_back(it->second);
+    }
+}
+
+void TSIndex::findByType(TSType* type, TSArray<void *>& results)
+{
+    // One check per distinct dynamic type rather than per element
+    for(TSDictionary<TSType *, TSArray<void *> >::iterator it = elementsByType.begin(); it != elementsByType.end(); it++)
+    {
+        if(it->first->is(type))
+        {
+            results.insert(results.end(), it->second.begin(), it->second.end());
+        }
+    }
+}
+
+TSType* TSIndex::typeOf(void* element)
+{
+    return typedElements ? ((TSObject *)element)->type : elementType;
+}
@@ -0,0 +1,196 @@
+/////////////////////////////////////////////////////////////////////////
+// TSIndex
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TSIndex_h
+#define TSIndex_h
+
+#include "TSType.h"
+#include <map>
+
+/////////////////////////////////////////////////////////////////////////
+// Hashing and ordering for the value types of indexed fields
+/////////////////////////////////////////////////////////////////////////
+class TSIndexKey
+{
+public:
+    typedef size_t (*HashFunction)(const void* value);
+    typedef bool (*LessFunction)(const void* value, const void* otherValue);
+    
+    HashFunction hash;
+    LessFunction less;
+    
+    // Global to all indexes
+    static void add(TSType* type, HashFunction hash, LessFunction less);
+    static const TSIndexKey* find(TSType* type);
+
+private:
+    static TSDictionary<TSType *, TSIndexKey>* keys;
+};
+
+/////////////////////////////////////////////////////////////////////////
+// Finds the elements of a reflected array by a field's value or by
+// their dynamic type. Elements are tracked by address, so arrays of
+// pointers can be changed with add and remove while arrays of values
+// have to be rebuilt when they reallocate.
+/////////////////////////////////////////////////////////////////////////
+class TSIndex
+{
+public:
+    enum Kind
+    {
+        Hash,
+        Sorted
+    };
+    
+    // elementType is the array's member type without the pointer, field
+    // comes from its getFieldByName or is NULL to index by type only
+    TSIndex(TSType* elementType, TSType* field, Kind kind = Hash);
+    ~TSIndex();
+    
+    // Replaces the contents with every element of array
+    void build(ArrayTypeClass* arrayType, void* array);
+    
+    void clear();
+    
+    // Remove an element before changing its indexed field. Both take
+    // constant time for Hash and logarithmic time for Sorted.
+    void add(void* element);
+    void remove(void* element);
+    
+    int count()
+    {
+        return elementCount;
+    }
+    
+    // Appends matching elements to results, optionally only those whose
+    // dynamic type is type or derives from it. Queries don't change the
+    // index, so several threads can run them while nothing is added.
+    void findEqual(const void* key, TSArray<void *>& results, TSType* type = NULL);
+    
+    // Between low and high inclusive, in order for Sorted indexes. Hash
+    // indexes answer by checking every distinct value, out of order.
+    void findRange(const void* low, const void* high, TSArray<void *>& results, TSType* type = NULL);
+    void findByType(TSType* type, TSArray<void *>& results);
+
+private:
+    TSIndex(const TSIndex&);
+    TSIndex& operator=(const TSIndex&);
+    
+    class Hasher
+    {
+    public:
+        const TSIndexKey* key;
+        
+        Hasher(const TSIndexKey* key) : key(key)
+        {
+        }
+        
+        // Hashed keys point at their group's value
+        size_t operator()(const void* const* value) const
+        {
+            return key->hash(*value);
+        }
+    };
+    
+    class Equal
+    {
+    public:
+        const TSIndexKey* key;
+        
+        Equal(const TSIndexKey* key) : key(key)
+        {
+        }
+        
+        bool operator()(const void* const* value, const void* const* otherValue) const
+        {
+            return !key->less(*value, *otherValue) && !key->less(*otherValue, *value);
+        }
+    };
+    
+    class Less
+    {
+    public:
+        const TSIndexKey* key;
+        
+        Less(const TSIndexKey* key) : key(key)
+        {
+        }
+        
+        bool operator()(const void* value, const void* otherValue) const
+        {
+            return key->less(value, otherValue);
+        }
+    };
+    
+    // Elements with equal values, value is the field of one of them
+    class Group
+    {
+    public:
+        const void* value;
+        TSArray<void *> elements;
+    };
+    
+    typedef std::unordered_map<const void * const *, Group *, Hasher, Equal> HashedElements;
+    typedef std::multimap<const void *, void *, Less> SortedElements;
+    
+    // Where an element is stored, so it's removed without searching
+    class Entry
+    {
+    public:
+        // In elementsByType
+        size_t position;
+        
+        // In group's elements for Hash, NULL when the field had no value
+        Group* group;
+        size_t groupPosition;
+        
+        // For Sorted, end when the field had no value
+        SortedElements::iterator sortedEntry;
+    };
+    
+    // Remembers the last dynamic type checked during one query
+    class TypeFilter
+    {
+    public:
+        TSType* type;
+        TSType* checkedType;
+        bool checkedResult;
+        
+        TypeFilter(TSType* type) : type(type), checkedType(NULL), checkedResult(false)
+        {
+        }
+        
+        bool matches(TSType* dynamicType)
+        {
+            if(!type)
+            {
+                return true;
+            }
+            
+            if(dynamicType != checkedType)
+            {
+                checkedType = dynamicType;
+                checkedResult = dynamicType->is(type);
+            }
+            
+            return checkedResult;
+        }
+    };
+    
+    // Dynamic type of element
+    TSType* typeOf(void* element);
+    
+    TSType* elementType;
+    bool typedElements;
+    TSType* field;
+    Kind kind;
+    const TSIndexKey* key;
+    HashedElements* hashed;
+    SortedElements* sorted;
+    TSDictionary<TSType *, TSArray<void *> > elementsByType;
+    TSDictionary<void *, Entry> entries;
+    int elementCount;
+};
+
+#endif
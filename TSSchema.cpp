@@ -0,0 +1,524 @@
+#include "TSSchema.h"
+
+TSDictionary<TSType *, TSSchema::Codec>* TSSchema::codecs = NULL;
+TSDictionary<TSString, TSSchema::ConvertFunction>* TSSchema::converters = NULL;
+TSDictionary<TSString, TSString>* TSSchema::renames = NULL;
+TSDictionary<TSString, TSSchemaPlan *>* TSSchemaPlan::plans = NULL;
+int TSSchemaPlan::generation = 0;
+
+/////////////////////////////////////////////////////////////////////////
+// Built in codecs
+/////////////////////////////////////////////////////////////////////////
+static void WriteString(TSType* type, void* value, TSString& out)
+{
+    out.append(*(TSString *)value);
+}
+
+static bool ReadString(TSType* type, void* value, const char* data, size_t size)
+{
+    ((TSString *)value)->assign(data, size);
+    return true;
+}
+
+static void WriteArray(TSType* type, void* value, TSString& out)
+{
+    ArrayTypeClass* arrayType = ArrayType->cast(type);
+    TSType* memberType = arrayType->memberType();
+    const TSSchema::Codec* codec = TSSchema::findCodec(memberType);
+    
+    int count = arrayType->count(value);
+    TSSchema::writeCount(out, count);
+    
+    TSString element;
+    for(int i = 0; i < count; i++)
+    {
+        element.clear();
+        codec->write(memberType, arrayType->childAtIndex(value, i), element);
+        TSSchema::writeCount(out, element.size());
+        out.append(element);
+    }
+}
+
+static bool ReadArray(TSType* type, void* value, const char* data, size_t size)
+{
+    ArrayTypeClass* arrayType = ArrayType->cast(type);
+    TSType* memberType = arrayType->memberType();
+    const TSSchema::Codec* codec = TSSchema::findCodec(memberType);
+    
+    const char* end = data + size;
+    size_t count;
+    if(!TSSchema::readCount(data, end, count) || count > size)
+    {
+        return false;
+    }
+    
+    if(!arrayType->resize(value, (int)count))
+    {
+        return false;
+    }
+    
+    for(size_t i = 0; i < count; i++)
+    {
+        size_t elementSize;
+        if(!TSSchema::readCount(data, end, elementSize) || elementSize > (size_t)(end - data))
+        {
+            return false;
+        }
+        
+        if(!codec->read(memberType, arrayType->childAtIndex(value, (int)i), data, elementSize))
+        {
+            return false;
+        }
+        
+        data += elementSize;
+    }
+    
+    return true;
+}
+
+static const TSSchema::Codec StringCodec = { WriteString, ReadString };
+static const TSSchema::Codec ArrayCodec = { WriteArray, ReadArray };
+
+/////////////////////////////////////////////////////////////////////////
+// TSSchema
+/////////////////////////////////////////////////////////////////////////
+TSSchema TSSchema::describe(TSType* type)
+{
+    TSArray<TSType *> chain;
+    for(TSType* currentType = type; currentType; currentType = currentType->base())
+    {
+        chain.push_back(currentType);
+    }
+    
+    // Base class fields come first
+    TSSchema schema;
+    for(size_t i = chain.size(); i > 0; --i)
+    {
+        const TSArray<TSType *>& fields = chain[i - 1]->fields;
+        size_t size = fields.size();
+        for(size_t j = 0; j < size; j++)
+        {
+            TSType* valueType = fields[j]->base();
+            
+            if(!findCodec(valueType))
+            {
+                continue;
+            }
+            
+            TSSchemaField field;
+            field.owner = chain[i - 1]->name;
+            field.name = fields[j]->description;
+            field.typeName = valueType->name;
+            schema.fields.push_back(field);
+        }
+    }
+    
+    schema.write(schema.key);
+    return schema;
+}
+
+void TSSchema::write(TSString& out) const
+{
+    writeCount(out, fields.size());
+    
+    size_t size = fields.size();
+    for(size_t i = 0; i < size; i++)
+    {
+        writeCount(out, fields[i].owner.size());
+        out.append(fields[i].owner);
+        writeCount(out, fields[i].name.size());
+        out.append(fields[i].name);
+        writeCount(out, fields[i].typeName.size());
+        out.append(fields[i].typeName);
+    }
+}
+
+bool TSSchema::read(const char*& cursor, const char* end)
+{
+    const char* start = cursor;
+    
+    size_t count;
+    if(!readCount(cursor, end, count) || count > (size_t)(end - cursor))
+    {
+        return false;
+    }
+    
+    fields.resize(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        size_t size;
+        if(!readCount(cursor, end, size) || size > (size_t)(end - cursor))
+        {
+            return false;
+        }
+        fields[i].owner.assign(cursor, size);
+        cursor += size;
+        
+        if(!readCount(cursor, end, size) || size > (size_t)(end - cursor))
+        {
+            return false;
+        }
+        fields[i].name.assign(cursor, size);
+        cursor += size;
+        
+        if(!readCount(cursor, end, size) || size > (size_t)(end - cursor))
+        {
+            return false;
+        }
+        fields[i].typeName.assign(cursor, size);
+        cursor += size;
+    }
+    
+    key.assign(start, cursor - start);
+    return true;
+}
+
+void TSSchema::addCodec(TSType* type, WriteFunction write, ReadFunction read)
+{
+    if(!codecs)
+    {
+        codecs = new TSDictionary<TSType *, Codec>;
+    }
+    
+    Codec& codec = (*codecs)[type];
+    codec.write = write;
+    codec.read = read;
+    
+    TSSchemaPlan::clear();
+}
+
+void TSSchema::addConverter(const TSString& fromTypeName, TSType* toType, ConvertFunction convert)
+{
+    if(!converters)
+    {
+        converters = new TSDictionary<TSString, ConvertFunction>;
+    }
+    
+    (*converters)[fromTypeName + '\n' + toType->name] = convert;
+    
+    TSSchemaPlan::clear();
+}
+
+void TSSchema::addRename(TSType* type, const TSString& oldName, const TSString& newName)
+{
+    if(!renames)
+    {
+        renames = new TSDictionary<TSString, TSString>;
+    }
+    
+    (*renames)[type->name + '\n' + oldName] = newName;
+    
+    TSSchemaPlan::clear();
+}
+
+const TSSchema::Codec* TSSchema::findCodec(TSType* type)
+{
+    for(TSType* currentType = type; currentType; currentType = currentType->base())
+    {
+        if(codecs)
+        {
+            TSDictionary<TSType *, Codec>::iterator it = codecs->find(currentType);
+            if(it != codecs->end())
+            {
+                return &it->second;
+            }
+        }
+        
+        if(currentType == TSStringType)
+        {
+            return &StringCodec;
+        }
+    }
+    
+    ArrayTypeClass* arrayType = ArrayType->cast(type);
+    if(arrayType && findCodec(arrayType->memberType()))
+    {
+        return &ArrayCodec;
+    }
+    
+    return NULL;
+}
+
+TSSchema::ConvertFunction TSSchema::findConverter(const TSString& fromTypeName, TSType* toType)
+{
+    if(!converters)
+    {
+        return NULL;
+    }
+    
+    TSDictionary<TSString, ConvertFunction>::iterator it = converters->find(fromTypeName + '\n' + toType->name);
+    return it == converters->end() ? NULL : it->second;
+}
+
+TSString TSSchema::findRename(TSType* type, const TSString& oldName)
+{
+    if(!renames)
+    {
+        return oldName;
+    }
+    
+    TSDictionary<TSString, TSString>::iterator it = renames->find(type->name + '\n' + oldName);
+    return it == renames->end() ? oldName : it->second;
+}
+
+// Field declared by type itself, not by its bases
+static TSType* FindDeclaredField(TSType* type, const TSString& name)
+{
+    const TSArray<TSType *>& fields = type->fields;
+    size_t size = fields.size();
+    for(size_t i = 0; i < size; i++)
+    {
+        if(fields[i]->description == name)
+        {
+            return fields[i];
+        }
+    }
+    
+    return NULL;
+}
+
+TSType* TSSchema::findField(TSType* type, const TSSchemaField& stored)
+{
+    for(TSType* currentType = type; currentType; currentType = currentType->base())
+    {
+        if(currentType->name == stored.owner)
+        {
+            return FindDeclaredField(currentType, findRename(currentType, stored.name));
+        }
+    }
+    
+    // The declaring class is no longer a base, the field may have moved
+    for(TSType* currentType = type; currentType; currentType = currentType->base())
+    {
+        TSType* field = FindDeclaredField(currentType, findRename(currentType, stored.name));
+        if(field)
+        {
+            return field;
+        }
+    }
+    
+    return NULL;
+}
+
+void TSSchema::writeCount(TSString& out, size_t count)
+{
+    while(count >= 0x80)
+    {
+        out.push_back((char)(count | 0x80));
+        count >>= 7;
+    }
+    out.push_back((char)count);
+}
+
+bool TSSchema::readCount(const char*& cursor, const char* end, size_t& count)
+{
+    count = 0;
+    for(int shift = 0; cursor != end && shift < 64; shift += 7)
+    {
+        unsigned char byte = (unsigned char)*cursor++;
+        count |= (size_t)(byte & 0x7f) << shift;
+        
+        if(!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// TSSchemaPlan
+/////////////////////////////////////////////////////////////////////////
+TSSchemaPlan::TSSchemaPlan(const TSSchema& stored, TSType* type)
+{
+    TSArray<TSType *> matched;
+    
+    size_t size = stored.fields.size();
+    for(size_t i = 0; i < size; i++)
+    {
+        const TSSchemaField& storedField = stored.fields[i];
+        
+        Step step;
+        step.operation = Skip;
+        step.field = TSSchema::findField(type, storedField);
+        step.valueType = NULL;
+        step.read = NULL;
+        step.convert = NULL;
+        
+        // A field stored twice only takes the first value
+        for(size_t j = 0; step.field && j < matched.size(); j++)
+        {
+            if(matched[j] == step.field) step.field = NULL;
+        }
+        
+        if(step.field)
+        {
+            step.valueType = step.field->base();
+            
+            const TSSchema::Codec* codec = TSSchema::findCodec(step.valueType);
+            if(codec && step.valueType->name == storedField.typeName)
+            {
+                step.operation = Copy;
+                step.read = codec->read;
+            }
+            else if((step.convert = TSSchema::findConverter(storedField.typeName, step.valueType)))
+            {
+                step.operation = Convert;
+            }
+            
+            if(step.operation != Skip)
+            {
+                matched.push_back(step.field);
+            }
+        }
+        
+        steps.push_back(step);
+    }
+    
+    for(TSType* currentType = type; currentType; currentType = currentType->base())
+    {
+        const TSArray<TSType *>& fields = currentType->fields;
+        for(size_t i = 0; i < fields.size(); i++)
+        {
+            // Fields that are never stored keep their value
+            bool found = !TSSchema::findCodec(fields[i]->base());
+            for(size_t j = 0; !found && j < matched.size(); j++)
+            {
+                found = matched[j] == fields[i];
+            }
+            
+            if(!found)
+            {
+                defaults.push_back(fields[i]);
+            }
+        }
+    }
+}
+
+TSSchemaPlan* TSSchemaPlan::find(const TSSchema& stored, TSType* type)
+{
+    if(!plans)
+    {
+        plans = new TSDictionary<TSString, TSSchemaPlan *>;
+    }
+    
+    TSSchemaPlan*& plan = (*plans)[type->name + '\n' + stored.key];
+    if(!plan)
+    {
+        plan = new TSSchemaPlan(stored, type);
+    }
+    
+    return plan;
+}
+
+void TSSchemaPlan::clear()
+{
+    generation++;
+    
+    if(!plans)
+    {
+        return;
+    }
+    
+    for(TSDictionary<TSString, TSSchemaPlan *>::iterator it = plans->begin(); it != plans->end(); it++)
+    {
+        delete it->second;
+    }
+    plans->clear();
+}
+
+bool TSSchemaPlan::apply(void* object, const char*& cursor, const char* end)
+{
+    size_t count = steps.size();
+    for(size_t i = 0; i < count; i++)
+    {
+        const Step& step = steps[i];
+        
+        size_t size;
+        if(!TSSchema::readCount(cursor, end, size) || size > (size_t)(end - cursor))
+        {
+            return false;
+        }
+        
+        switch(step.operation)
+        {
+            case Copy:
+                if(!step.read(step.valueType, step.field->get(object), cursor, size)) return false;
+                break;
+            
+            case Convert:
+                if(!step.convert(step.field->get(object), cursor, size)) return false;
+                break;
+            
+            case Skip:
+                break;
+        }
+        
+        cursor += size;
+    }
+    
+    count = defaults.size();
+    for(size_t i = 0; i < count; i++)
+    {
+        defaults[i]->setDefaultValue(object);
+    }
+    
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// TSSchemaWriter / TSSchemaReader
+/////////////////////////////////////////////////////////////////////////
+TSSchemaWriter::TSSchemaWriter(TSType* type, TSString& out) : out(out)
+{
+    TSSchema schema = TSSchema::describe(type);
+    out.append(schema.key);
+    
+    size_t size = schema.fields.size();
+    for(size_t i = 0; i < size; i++)
+    {
+        TSType* field = TSSchema::findField(type, schema.fields[i]);
+        fields.push_back(field);
+        codecs.push_back(TSSchema::findCodec(field->base()));
+    }
+}
+
+void TSSchemaWriter::write(void* object)
+{
+    TSString value;
+    
+    size_t size = fields.size();
+    for(size_t i = 0; i < size; i++)
+    {
+        value.clear();
+        codecs[i]->write(fields[i]->base(), fields[i]->get(object), value);
+        TSSchema::writeCount(out, value.size());
+        out.append(value);
+    }
+}
+
+TSSchemaReader::TSSchemaReader(TSType* type, const char* data, size_t size) :
+    type(type), plan(NULL), planGeneration(TSSchemaPlan::generation), cursor(data), end(data + size)
+{
+    if(stored.read(cursor, end))
+    {
+        plan = TSSchemaPlan::find(stored, type);
+    }
+}
+
+bool TSSchemaReader::read(void* object)
+{
+    if(!plan || cursor == end)
+    {
+        return false;
+    }
+    
+    if(planGeneration != TSSchemaPlan::generation)
+    {
+        plan = TSSchemaPlan::find(stored, type);
+        planGeneration = TSSchemaPlan::generation;
+    }
+    
+    return plan->apply(object, cursor, end);
+}
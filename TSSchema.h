@@ -0,0 +1,166 @@
+/////////////////////////////////////////////////////////////////////////
+// TSSchema
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TSSchema_h
+#define TSSchema_h
+
+#include "TSType.h"
+
+/////////////////////////////////////////////////////////////////////////
+// Compact description of a type's fields (names, field types, order)
+/////////////////////////////////////////////////////////////////////////
+class TSSchemaField
+{
+public:
+    // Name of the class that declares the field, keeps fields that a
+    // derived class shadows apart
+    TSString owner;
+    TSString name;
+    TSString typeName;
+};
+
+class TSSchema
+{
+public:
+    // Writes a value of type to out, reads a value of type from data
+    typedef void (*WriteFunction)(TSType* type, void* value, TSString& out);
+    typedef bool (*ReadFunction)(TSType* type, void* value, const char* data, size_t size);
+    
+    // Reads a value stored with a different field type
+    typedef bool (*ConvertFunction)(void* value, const char* data, size_t size);
+    
+    class Codec
+    {
+    public:
+        WriteFunction write;
+        ReadFunction read;
+    };
+    
+    TSArray<TSSchemaField> fields;
+    
+    // Encoded form, identifies the schema in the plan cache
+    TSString key;
+    
+    static TSSchema describe(TSType* type);
+    
+    void write(TSString& out) const;
+    bool read(const char*& cursor, const char* end);
+    
+    // Global to all schemas
+    static void addCodec(TSType* type, WriteFunction write, ReadFunction read);
+    static void addConverter(const TSString& fromTypeName, TSType* toType, ConvertFunction convert);
+    // type is the class that declares the field
+    static void addRename(TSType* type, const TSString& oldName, const TSString& newName);
+    
+    static const Codec* findCodec(TSType* type);
+    static ConvertFunction findConverter(const TSString& fromTypeName, TSType* toType);
+    static TSString findRename(TSType* type, const TSString& oldName);
+    
+    // Field of type or its bases that stored describes, after renames
+    static TSType* findField(TSType* type, const TSSchemaField& stored);
+    
+    // Variable length integers used by the encoding
+    static void writeCount(TSString& out, size_t count);
+    static bool readCount(const char*& cursor, const char* end, size_t& count);
+
+private:
+    static TSDictionary<TSType *, Codec>* codecs;
+    static TSDictionary<TSString, ConvertFunction>* converters;
+    static TSDictionary<TSString, TSString>* renames;
+};
+
+/////////////////////////////////////////////////////////////////////////
+// Maps records of a stored schema onto the live type, cached per pair.
+// The cache is global and not thread safe: register codecs, converters
+// and renames and load data from one thread at a time. Registering
+// clears the cache, so later reads pick up the new mapping.
+/////////////////////////////////////////////////////////////////////////
+class TSSchemaPlan
+{
+public:
+    enum Operation
+    {
+        Copy,
+        Skip,
+        Convert
+    };
+    
+    class Step
+    {
+    public:
+        Operation operation;
+        TSType* field;
+        TSType* valueType;
+        TSSchema::ReadFunction read;
+        TSSchema::ConvertFunction convert;
+    };
+    
+    // One step per stored field, in stored order
+    TSArray<Step> steps;
+    
+    // Stored live fields that have no value in the data
+    TSArray<TSType *> defaults;
+    
+    static TSSchemaPlan* find(const TSSchema& stored, TSType* type);
+    
+    // Frees every cached plan, readers fetch a new one on their next read
+    static void clear();
+    
+    // Changes whenever the cache is cleared
+    static int generation;
+    
+    bool apply(void* object, const char*& cursor, const char* end);
+
+private:
+    TSSchemaPlan(const TSSchema& stored, TSType* type);
+    
+    static TSDictionary<TSString, TSSchemaPlan *>* plans;
+};
+
+/////////////////////////////////////////////////////////////////////////
+// Schema header followed by records
+/////////////////////////////////////////////////////////////////////////
+class TSSchemaWriter
+{
+public:
+    TSSchemaWriter(TSType* type, TSString& out);
+    
+    void write(void* object);
+
+private:
+    TSString& out;
+    TSArray<TSType *> fields;
+    TSArray<const TSSchema::Codec *> codecs;
+};
+
+class TSSchemaReader
+{
+public:
+    TSSchemaReader(TSType* type, const char* data, size_t size);
+    
+    // False when the header could not be read
+    bool isValid()
+    {
+        return plan != NULL;
+    }
+    
+    bool atEnd()
+    {
+        return cursor == end;
+    }
+    
+    // Fills object from the next record, false at the end or on bad data
+    bool read(void* object);
+    
+    TSSchema stored;
+
+private:
+    TSType* type;
+    TSSchemaPlan* plan;
+    int planGeneration;
+    const char* cursor;
+    const char* end;
+};
+
+#endif
@@ -15,6 +15,12 @@ TSField(TSString, TSType, description, "unnnamed type");
 
 TSImplementTypeClass(Array, "abstract array");
 TSImplementTypeClass(Pointer, "abstract pointer");
+TSImplementTypeClass(Dictionary, "abstract dictionary");
+TSImplementTypeClass(Deque, "abstract deque");
+TSImplementTypeClass(Method, "abstract method");
+
+TSArray<MethodTypeClass *>* MethodTypeClass::methodsById = NULL;
+TSArray<MethodTypeClass::Thunk>* MethodTypeClass::thunksById = NULL;
 
 TSImplementType(ContainerBase, "container base");
 
@@ -24,6 +30,8 @@ TSImplementType(GenericReference, "untyped reference");
 TSField(TSString, GenericReference, id, "unnamed");
 
 TSImplementType(TSString, "text");
+TSImplementTypeClass(TSStringDictionary, "text dictionary");
+TSImplementTypeClass(TSStringDeque, "text deque");
 
 // A SEGFAULT HERE MEANS THAT YOU ARE
 // PROBABLY MISSING THE MATCHING CPP
@@ -122,6 +130,114 @@ TSType* TSType::getFieldByName(const TSString& name)
     return NULL;
 }
 
+TSType* TSType::getFieldByDescription(const char* description, size_t length)
+{
+    for(TSType* type = (TSType *)this; type != NULL; type = type->base())
+    {
+        const TSArray<TSType *>& fields = type->fields;
+		size_t size = fields.size();
+        for(size_t i = 0; i < size; i++)
+        {
+            TSType* field = fields[i];
+            
+            if(field->description.compare(0, TSString::npos, description, length) == 0)
+            {
+                return field;
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+TSType* TSType::getMethodByName(const TSString& name)
+{
+    for(TSType* type = (TSType *)this; type != NULL; type = type->base())
+    {
+        const TSArray<TSType *>& methods = type->methods;
+		size_t size = methods.size();
+        for(size_t i = 0; i < size; i++)
+        {
+            TSType* method = methods[i];
+            
+            if(method->name == name)
+            {
+                return method;
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+int TSType::getMethodIdByName(const TSString& name)
+{
+    MethodTypeClass* method = MethodType->cast(getMethodByName(name));
+    return method ? method->id : -1;
+}
+
+void MethodTypeClass::registerMethod(TSType* ownerType, Thunk methodThunk)
+{
+    if(!methodsById)
+    {
+        methodsById = new TSArray<MethodTypeClass *>;
+        thunksById = new TSArray<Thunk>;
+    }
+    
+    id = (int)methodsById->size();
+    thunk = methodThunk;
+    methodsById->push_back(this);
+    thunksById->push_back(methodThunk);
+    ownerType->methods.push_back(this);
+}
+
+bool TSFieldsEqual(TSType* type, void* value, void* otherValue)
+{
+    // Values that can't be inspected are treated as changed
+    if(!type) return false;
+    
+    if(type->is(TSObjectType))
+    {
+        TSObject* object = TSObjectType->cast(value);
+        TSObject* otherObject = TSObjectType->cast(otherValue);
+        if(object->type != otherObject->type) return false;
+        
+        type = object->type;
+    }
+    
+    for(; type; type = type->base())
+    {
+        size_t size = type->fields.size();
+        for(size_t i = 0; i < size; i++)
+        {
+            if(!type->fields[i]->equalValues(value, otherValue))
+            {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+// Resolves pointers and the dynamic type of a container's member
+static void PrintChildHierarchy(TSType* childType, void* childValue, int maxLevelsDeep, int levelsDeep)
+{
+    if(childType->is(PointerType))
+    {
+        childType = PointerType->cast(childType)->dereferenced();
+        childValue = *(void **)childValue;
+    }
+    
+    if(childValue && childType->is(TSObjectType))
+    {
+        TSObject* object = TSObjectType->cast(childValue);
+        childType = object->type;
+    }
+    
+    PrintObjectHierarchy(childType, childValue, maxLevelsDeep, levelsDeep);
+}
+
 void PrintObjectHierarchy(TSType* type, void* value, int maxLevelsDeep, int levelsDeep)
 {
     if(levelsDeep == maxLevelsDeep) return;
@@ -174,21 +290,43 @@ void PrintObjectHierarchy(TSType* type, void* value, int maxLevelsDeep, int leve
         for(int childIndex = 0; childIndex < count; childIndex++)
         {
             void* childValue = arrayType->childAtIndex(value, childIndex);
-            
-            TSType* childType = arrayType->memberType();
-            if(childType->is(PointerType))
+            PrintChildHierarchy(arrayType->memberType(), childValue, maxLevelsDeep, levelsDeep + 1);
+        }
+        return;
+    }
+    
+    DequeTypeClass* dequeType = DequeType->cast(type);
+    if(dequeType)
+    {
+        void* childValues[64];
+        int index = 0;
+        while(int count = dequeType->nextBatch(value, index, childValues, 64))
+        {
+            for(int i = 0; i < count; i++)
             {
-                childType = PointerType->cast(childType)->dereferenced();
-                childValue = *(void **)childValue;
+                PrintChildHierarchy(dequeType->memberType(), childValues[i], maxLevelsDeep, levelsDeep + 1);
             }
-            
-            if(childValue && childType->is(TSObjectType))
+        }
+        return;
+    }
+    
+    DictionaryTypeClass* dictionaryType = DictionaryType->cast(type);
+    if(dictionaryType)
+    {
+        const TSString* keys[64];
+        void* childValues[64];
+        DictionaryTypeClass::Cursor cursor;
+        while(int count = dictionaryType->nextBatch(value, cursor, keys, childValues, 64))
+        {
+            for(int i = 0; i < count; i++)
             {
-                TSObject* object = TSObjectType->cast(childValue);
-                childType = object->type;
+                if(levelsDeep + 1 == maxLevelsDeep) return;
+                
+                for(int j = (levelsDeep + 1) * 4; j > 0; --j) putchar(' ');
+                printf("[\"%s\"]\n", keys[i]->c_str());
+                
+                PrintChildHierarchy(dictionaryType->memberType(), childValues[i], maxLevelsDeep, levelsDeep + 2);
             }
-            
-            PrintObjectHierarchy(childType, childValue, maxLevelsDeep, levelsDeep + 1);
         }
         return;
     }
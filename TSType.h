@@ -9,6 +9,8 @@
 #include <deque>
 #include <unordered_map>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 #define TSArray std::vector
 #define TSDeque std::deque
@@ -32,6 +34,8 @@ public:
     // make protected, forces 
     static TSType typeInstance;
     
+    virtual ~TSType() {}
+    
     virtual TSType* base() { return NULL; }
     
     // Type checking and casting
@@ -43,18 +47,30 @@ public:
         return NULL;
     }
     
+    // Shallow copy of object made with its copy constructor, NULL for
+    // types that can't be copied
+    virtual void* clone(void* object)
+    {
+        return NULL;
+    }
+    
     virtual int sizeOf()
     {
         return sizeof(TSEmpty);
     }
     
-    void destroy(void* object)
+    virtual void destroy(void* object)
     {
         delete object;
     }
     
     TSArray<TSType *> fields;
     TSType* getFieldByName(const TSString& name);
+    TSType* getFieldByDescription(const char* description, size_t length);
+    
+    TSArray<TSType *> methods;
+    TSType* getMethodByName(const TSString& name);
+    int getMethodIdByName(const TSString& name);
     
     TSString name;
     TSString description;
@@ -69,6 +85,12 @@ public:
         
     }
     
+    // Compares the field's value in two owners
+    virtual bool equalValues(void* somePointer, void* otherPointer)
+    {
+        return true;
+    }
+    
 private:
     TSType();
     
@@ -86,6 +108,96 @@ protected:
 typedef TSType TSEmptyTypeClass;
 extern TSEmptyTypeClass* TSEmptyType;
 
+// Maps a C++ type to its type singleton, NULL for unreflected types
+template <class T>
+struct TSTypeOf
+{
+    static TSType* type()
+    {
+        return NULL;
+    }
+};
+
+#define TSDeclareTypeOf(CLASS) \
+template <> \
+struct TSTypeOf<CLASS> \
+{ \
+    static TSType* type() \
+    { \
+        return CLASS##Type; \
+    } \
+};
+
+TSDeclareTypeOf(TSEmpty)
+
+template <>
+struct TSTypeOf<void>
+{
+    static TSType* type()
+    {
+        return TSEmptyType;
+    }
+};
+
+// Resizes container, false when its elements can't be default constructed
+// and moved. Only instantiates resize for elements that support it, so
+// types with members like std::mutex can still be reflected.
+template <class T>
+struct TSResizable : std::integral_constant<bool,
+    std::is_default_constructible<T>::value && std::is_move_constructible<T>::value>
+{
+};
+
+template <class Container>
+typename std::enable_if<TSResizable<typename Container::value_type>::value, bool>::type
+TSResize(Container& container, int count)
+{
+    container.resize(count);
+    return true;
+}
+
+template <class Container>
+typename std::enable_if<!TSResizable<typename Container::value_type>::value, bool>::type
+TSResize(Container& container, int count)
+{
+    return (int)container.size() == count;
+}
+
+// Copies value with its copy constructor, NULL when T can't be copied.
+// Containers are checked by their elements, their own copy constructors
+// exist even when the elements have none.
+template <class T>
+struct TSCopyable : std::is_copy_constructible<T>
+{
+};
+
+template <class T>
+struct TSCopyable<TSArray<T> > : TSCopyable<T>
+{
+};
+
+template <class T>
+struct TSCopyable<TSDeque<T> > : TSCopyable<T>
+{
+};
+
+template <class Key, class T>
+struct TSCopyable<TSDictionary<Key, T> > : TSCopyable<T>
+{
+};
+
+template <class T>
+typename std::enable_if<TSCopyable<T>::value, void*>::type TSClone(const void* value)
+{
+    return new T(*(const T *)value);
+}
+
+template <class T>
+typename std::enable_if<!TSCopyable<T>::value, void*>::type TSClone(const void* value)
+{
+    return NULL;
+}
+
 /////////////////////////////////////////////////////////////////////////
 // TSObject
 /////////////////////////////////////////////////////////////////////////
@@ -93,6 +205,7 @@ class TSObject : public TSEmpty
 {
 public:
     TSType* type;
+    virtual ~TSObject() {}
     virtual bool is(TSType* otherType);
     virtual void destroy();
 };
@@ -137,17 +250,28 @@ public:
         return newClass;
     }
     
+    virtual void* clone(void* object)
+    {
+        return new TSObject(*(TSObject *)object);
+    }
+    
     virtual int sizeOf()
     {
         return sizeof(TSObject);
     }
     
+    virtual void destroy(void* object)
+    {
+        delete (TSObject *)object;
+    }
+    
 protected:
     TSObjectTypeClass(const TSString& name, const TSString& description) : TSType(name, description)
     {
     }
 };
 extern TSObjectTypeClass* TSObjectType;
+TSDeclareTypeOf(TSObject)
 
 /////////////////////////////////////////////////////////////////////////
 // Creates a new type for class (with casting), linked with a base type
@@ -204,9 +328,17 @@ public: \
         } \
         return newClass; \
     } \
+    virtual void* clone(void* object) \
+    { \
+        return TSClone<CLASS>(object); \
+    } \
     virtual int sizeOf() \
     { \
         return sizeof(CLASS); \
+    } \
+    virtual void destroy(void* object) \
+    { \
+        delete (CLASS *)object; \
     }
 
 
@@ -216,7 +348,8 @@ class CLASS##TypeClass : public PARENT##TypeClass \
 TSDeclareTypeClassAbstractMembers(CLASS, PARENT) \
 TSDeclareTypeClassMembers(CLASS) \
 }; \
-extern CLASS##TypeClass* CLASS##Type;
+extern CLASS##TypeClass* CLASS##Type; \
+TSDeclareTypeOf(CLASS)
 
 #define TSDeclareAbstractTypeClass(CLASS, PARENT) \
 class CLASS##TypeClass : public PARENT##TypeClass \
@@ -252,8 +385,13 @@ public: \
     { \
         return sizeof(CLASS); \
     } \
+    virtual void destroy(void* object) \
+    { \
+        delete (CLASS *)object; \
+    } \
 }; \
-extern CLASS##TypeClass* CLASS##Type;
+extern CLASS##TypeClass* CLASS##Type; \
+TSDeclareTypeOf(CLASS)
 
 /////////////////////////////////////////////////////////////////////////
 // Pointer types
@@ -282,7 +420,8 @@ public: \
         return CLASS##Type; \
     } \
 }; \
-extern CLASS##PtrTypeClass* CLASS##PtrType;
+extern CLASS##PtrTypeClass* CLASS##PtrType; \
+TSDeclareTypeOf(CLASS##Ptr)
 
 /////////////////////////////////////////////////////////////////////////
 // Array types
@@ -306,6 +445,12 @@ public:
     {
         return NULL;
     }
+    
+    // False when the member type can't be default constructed and moved
+    virtual bool resize(void* object, int count)
+    {
+        return false;
+    }
 };
 extern ArrayTypeClass* ArrayType;
 
@@ -328,8 +473,379 @@ virtual void* childAtIndex(void* object, int index) \
 { \
 return &(*((CLASS##Array *)object))[index]; \
 } \
+virtual bool resize(void* object, int count) \
+{ \
+return TSResize(*(CLASS##Array *)object, count); \
+} \
+}; \
+extern CLASS##ArrayTypeClass* CLASS##ArrayType; \
+TSDeclareTypeOf(CLASS##Array)
+
+/////////////////////////////////////////////////////////////////////////
+// Dictionary types, keyed by TSString
+/////////////////////////////////////////////////////////////////////////
+class DictionaryTypeClass : public TSType
+{
+    TSDeclareTypeClassAbstractMembers(Dictionary, TSEmpty);
+    
+public:
+    // Position of the next batch, starts at the beginning. A cursor walks
+    // one dictionary once, adding or removing entries invalidates it.
+    class Cursor
+    {
+    public:
+        // Entries returned so far
+        size_t visited;
+        
+        // Iterator into the dictionary, allocated by the first batch
+        void* iterator;
+        void (*release)(void* iterator);
+        
+        Cursor() : visited(0), iterator(NULL), release(NULL)
+        {
+        }
+        
+        ~Cursor()
+        {
+            if(release) release(iterator);
+        }
+        
+    private:
+        Cursor(const Cursor&);
+        Cursor& operator=(const Cursor&);
+    };
+    
+    virtual TSType* keyType()
+    {
+        return NULL;
+    }
+    
+    virtual TSType* memberType()
+    {
+        return NULL;
+    }
+    
+    virtual int count(void* object)
+    {
+        return 0;
+    }
+    
+    virtual void reserve(void* object, int count)
+    {
+    }
+    
+    // Value stored under key or NULL
+    virtual void* find(void* object, const TSString& key)
+    {
+        return NULL;
+    }
+    
+    // Value stored under key, added if missing
+    virtual void* insert(void* object, const TSString& key)
+    {
+        return NULL;
+    }
+    
+    virtual bool remove(void* object, const TSString& key)
+    {
+        return false;
+    }
+    
+    // Fills up to maxCount key and value pointers, returns 0 at the end
+    virtual int nextBatch(void* object, Cursor& cursor, const TSString** keys, void** values, int maxCount)
+    {
+        return 0;
+    }
+};
+extern DictionaryTypeClass* DictionaryType;
+
+#define TSDeclareDictionaryType(CLASS) \
+typedef TSDictionary<TSString, CLASS> CLASS##Dictionary; \
+class CLASS##DictionaryTypeClass : public DictionaryTypeClass \
+{ \
+    TSDeclareTypeClassAbstractMembers(CLASS##Dictionary, Dictionary) \
+    TSDeclareTypeClassMembers(CLASS##Dictionary) \
+public: \
+    virtual TSType* keyType() \
+    { \
+        return TSStringType; \
+    } \
+    virtual TSType* memberType() \
+    { \
+        return CLASS##Type; \
+    } \
+    virtual int count(void* object) \
+    { \
+        return (int)((CLASS##Dictionary *)object)->size(); \
+    } \
+    virtual void reserve(void* object, int count) \
+    { \
+        ((CLASS##Dictionary *)object)->reserve(count); \
+    } \
+    virtual void* find(void* object, const TSString& key) \
+    { \
+        CLASS##Dictionary::iterator it = ((CLASS##Dictionary *)object)->find(key); \
+        return it == ((CLASS##Dictionary *)object)->end() ? NULL : &it->second; \
+    } \
+    virtual void* insert(void* object, const TSString& key) \
+    { \
+        return &(*((CLASS##Dictionary *)object))[key]; \
+    } \
+    virtual bool remove(void* object, const TSString& key) \
+    { \
+        return ((CLASS##Dictionary *)object)->erase(key) != 0; \
+    } \
+    typedef CLASS##Dictionary::iterator Iterator; \
+    static void releaseIterator(void* iterator) \
+    { \
+        delete (Iterator *)iterator; \
+    } \
+    virtual int nextBatch(void* object, Cursor& cursor, const TSString** keys, void** values, int maxCount) \
+    { \
+        CLASS##Dictionary* dictionary = (CLASS##Dictionary *)object; \
+        if(!cursor.iterator) \
+        { \
+            cursor.iterator = new Iterator(dictionary->begin()); \
+            cursor.release = releaseIterator; \
+        } \
+        Iterator& it = *(Iterator *)cursor.iterator; \
+        size_t size = dictionary->size(); \
+        int written = 0; \
+        for(; written < maxCount && cursor.visited < size; ++it, ++written, ++cursor.visited) \
+        { \
+            keys[written] = &it->first; \
+            values[written] = &it->second; \
+        } \
+        return written; \
+    } \
 }; \
-extern CLASS##ArrayTypeClass* CLASS##ArrayType;
+extern CLASS##DictionaryTypeClass* CLASS##DictionaryType; \
+TSDeclareTypeOf(CLASS##Dictionary)
+
+/////////////////////////////////////////////////////////////////////////
+// Deque types
+/////////////////////////////////////////////////////////////////////////
+class DequeTypeClass : public TSType
+{
+    TSDeclareTypeClassAbstractMembers(Deque, TSEmpty);
+    
+public:
+    virtual TSType* memberType()
+    {
+        return NULL;
+    }
+    
+    virtual int count(void* object)
+    {
+        return 0;
+    }
+    
+    virtual void* childAtIndex(void* object, int index)
+    {
+        return NULL;
+    }
+    
+    // False when the member type can't be default constructed and moved
+    virtual bool resize(void* object, int count)
+    {
+        return false;
+    }
+    
+    // Fills up to maxCount value pointers starting at index, returns 0 at the end
+    virtual int nextBatch(void* object, int& index, void** values, int maxCount)
+    {
+        return 0;
+    }
+};
+extern DequeTypeClass* DequeType;
+
+#define TSDeclareDequeType(CLASS) \
+typedef TSDeque<CLASS> CLASS##Deque; \
+class CLASS##DequeTypeClass : public DequeTypeClass \
+{ \
+    TSDeclareTypeClassAbstractMembers(CLASS##Deque, Deque) \
+    TSDeclareTypeClassMembers(CLASS##Deque) \
+public: \
+    virtual TSType* memberType() \
+    { \
+        return CLASS##Type; \
+    } \
+    virtual int count(void* object) \
+    { \
+        return (int)((CLASS##Deque *)object)->size(); \
+    } \
+    virtual void* childAtIndex(void* object, int index) \
+    { \
+        return &(*((CLASS##Deque *)object))[index]; \
+    } \
+    virtual bool resize(void* object, int count) \
+    { \
+        return TSResize(*(CLASS##Deque *)object, count); \
+    } \
+    virtual int nextBatch(void* object, int& index, void** values, int maxCount) \
+    { \
+        CLASS##Deque* deque = (CLASS##Deque *)object; \
+        int size = (int)deque->size(); \
+        int written = 0; \
+        if(index < size) \
+        { \
+            CLASS##Deque::iterator it = deque->begin() + index; \
+            for(; index < size && written < maxCount; ++it, ++index, ++written) \
+            { \
+                values[written] = &*it; \
+            } \
+        } \
+        return written; \
+    } \
+}; \
+extern CLASS##DequeTypeClass* CLASS##DequeType; \
+TSDeclareTypeOf(CLASS##Deque)
+
+/////////////////////////////////////////////////////////////////////////
+// Method types
+/////////////////////////////////////////////////////////////////////////
+class MethodTypeClass : public TSType
+{
+    TSDeclareTypeClassAbstractMembers(Method, TSEmpty);
+    
+public:
+    // Arguments are passed as an array of pointers to the caller's values,
+    // the result is assigned to *result unless result is NULL
+    typedef void (*Thunk)(void* owner, void** arguments, void* result);
+    
+    // Global to all methods, indexed by id
+    static TSArray<MethodTypeClass *>* methodsById;
+    static TSArray<Thunk>* thunksById;
+    
+    static MethodTypeClass* findById(int id)
+    {
+        return (*methodsById)[id];
+    }
+    
+    static void invokeById(int id, void* owner, void** arguments, void* result = NULL)
+    {
+        (*thunksById)[id](owner, arguments, result);
+    }
+    
+    int id;
+    Thunk thunk;
+    
+    void invoke(void* owner, void** arguments, void* result = NULL)
+    {
+        thunk(owner, arguments, result);
+    }
+    
+    virtual TSType* returnType()
+    {
+        return NULL;
+    }
+    
+    virtual int argumentCount()
+    {
+        return 0;
+    }
+    
+    virtual TSType* argumentType(int index)
+    {
+        return NULL;
+    }
+    
+protected:
+    void registerMethod(TSType* ownerType, Thunk methodThunk);
+};
+extern MethodTypeClass* MethodType;
+
+template <int... I>
+struct TSIndices {};
+
+template <int N, int... I>
+struct TSMakeIndices : TSMakeIndices<N - 1, N - 1, I...> {};
+
+template <int... I>
+struct TSMakeIndices<0, I...>
+{
+    typedef TSIndices<I...> type;
+};
+
+template <class Owner, class Return, class... Arguments>
+struct TSMethodCall
+{
+    template <class Method, Method method, int... I>
+    static void call(void* owner, void** arguments, void* result, TSIndices<I...>)
+    {
+        Return value = (((Owner *)owner)->*method)(
+            static_cast<Arguments>(*(typename std::remove_reference<Arguments>::type *)arguments[I])...);
+        
+        // Moves returned values, copies returned references
+        if(result)
+        {
+            *(typename std::decay<Return>::type *)result = std::forward<Return>(value);
+        }
+    }
+    
+    static TSType* returnType()
+    {
+        return TSTypeOf<typename std::decay<Return>::type>::type();
+    }
+    
+    static TSType* argumentType(int index)
+    {
+        TSType* types[] = { TSTypeOf<typename std::decay<Arguments>::type>::type()..., NULL };
+        return index >= 0 && index < (int)sizeof...(Arguments) ? types[index] : NULL;
+    }
+};
+
+template <class Owner, class... Arguments>
+struct TSMethodCall<Owner, void, Arguments...>
+{
+    template <class Method, Method method, int... I>
+    static void call(void* owner, void** arguments, void* result, TSIndices<I...>)
+    {
+        (((Owner *)owner)->*method)(
+            static_cast<Arguments>(*(typename std::remove_reference<Arguments>::type *)arguments[I])...);
+    }
+    
+    static TSType* returnType()
+    {
+        return TSTypeOf<void>::type();
+    }
+    
+    static TSType* argumentType(int index)
+    {
+        TSType* types[] = { TSTypeOf<typename std::decay<Arguments>::type>::type()..., NULL };
+        return index >= 0 && index < (int)sizeof...(Arguments) ? types[index] : NULL;
+    }
+};
+
+// Type-erased entry point for one method, resolved at compile time
+template <class Owner, class Method, Method method>
+struct TSMethodThunk;
+
+template <class Owner, class Class, class Return, class... Arguments, Return (Class::*method)(Arguments...)>
+struct TSMethodThunk<Owner, Return (Class::*)(Arguments...), method> : 
+    TSMethodCall<Owner, Return, Arguments...>
+{
+    static const int argumentCount = sizeof...(Arguments);
+    
+    static void invoke(void* owner, void** arguments, void* result)
+    {
+        TSMethodCall<Owner, Return, Arguments...>::template call<Return (Class::*)(Arguments...), method>(
+            owner, arguments, result, typename TSMakeIndices<sizeof...(Arguments)>::type());
+    }
+};
+
+template <class Owner, class Class, class Return, class... Arguments, Return (Class::*method)(Arguments...) const>
+struct TSMethodThunk<Owner, Return (Class::*)(Arguments...) const, method> : 
+    TSMethodCall<Owner, Return, Arguments...>
+{
+    static const int argumentCount = sizeof...(Arguments);
+    
+    static void invoke(void* owner, void** arguments, void* result)
+    {
+        TSMethodCall<Owner, Return, Arguments...>::template call<Return (Class::*)(Arguments...) const, method>(
+            owner, arguments, result, typename TSMakeIndices<sizeof...(Arguments)>::type());
+    }
+};
 
 /////////////////////////////////////////////////////////////////////////
 // Putting it all together
@@ -367,6 +883,62 @@ TSImplementTypeClass(CLASS##Ptr,                                FRIENDLYNAME "*"
 TSImplementTypeClass(CLASS##PtrArray,                           FRIENDLYNAME "* array") \
 TSImplementTypeClass(CLASS##PtrArrayPtr,                        FRIENDLYNAME "* array pointer")
 
+// Compares two values of type field by field
+bool TSFieldsEqual(TSType* type, void* value, void* otherValue);
+
+// Uses operator== when the value has one, reflection otherwise
+template <class T>
+auto TSValueEquals(const T& value, const T& otherValue, int) -> decltype(bool(value == otherValue))
+{
+    return value == otherValue;
+}
+
+template <class T>
+bool TSValueEquals(const T& value, const T& otherValue, long)
+{
+    return TSFieldsEqual(TSTypeOf<T>::type(), (void *)&value, (void *)&otherValue);
+}
+
+template <class T>
+bool TSValueEquals(const TSArray<T>& value, const TSArray<T>& otherValue, int)
+{
+    if(value.size() != otherValue.size()) return false;
+    
+    for(size_t i = 0; i < value.size(); i++)
+    {
+        if(!TSValueEquals(value[i], otherValue[i], 0)) return false;
+    }
+    
+    return true;
+}
+
+template <class T>
+bool TSValueEquals(const TSDeque<T>& value, const TSDeque<T>& otherValue, int)
+{
+    if(value.size() != otherValue.size()) return false;
+    
+    for(size_t i = 0; i < value.size(); i++)
+    {
+        if(!TSValueEquals(value[i], otherValue[i], 0)) return false;
+    }
+    
+    return true;
+}
+
+template <class T>
+bool TSValueEquals(const TSDictionary<TSString, T>& value, const TSDictionary<TSString, T>& otherValue, int)
+{
+    if(value.size() != otherValue.size()) return false;
+    
+    for(typename TSDictionary<TSString, T>::const_iterator it = value.begin(); it != value.end(); it++)
+    {
+        typename TSDictionary<TSString, T>::const_iterator other = otherValue.find(it->first);
+        if(other == otherValue.end() || !TSValueEquals(it->second, other->second, 0)) return false;
+    }
+    
+    return true;
+}
+
 #define TSField(FIELDCLASS, CLASS, FIELD, DEFAULTVALUE) \
 class CLASS##FIELD##FieldTypeClass : public FIELDCLASS##TypeClass \
 { \
@@ -408,9 +980,55 @@ public: \
             owner->FIELD = DEFAULTVALUE; \
         } \
     } \
+    virtual bool equalValues(void* somePointer, void* otherPointer) \
+    { \
+        CLASS* owner = CLASS##Type->cast(somePointer); \
+        CLASS* other = CLASS##Type->cast(otherPointer); \
+        return owner && other ? TSValueEquals(owner->FIELD, other->FIELD, 0) : owner == other; \
+    } \
 }; \
 CLASS##FIELD##FieldTypeClass CLASS##FIELD##FieldTypeClass::typeInstance(#CLASS #FIELD, #FIELD);
 
+#define TSMethod(CLASS, METHOD) \
+class CLASS##METHOD##MethodTypeClass : public MethodTypeClass \
+{ \
+public: \
+    static CLASS##METHOD##Method##TypeClass typeInstance; \
+    typedef TSMethodThunk<CLASS, decltype(&CLASS::METHOD), &CLASS::METHOD> Invoker; \
+    TSType* base() \
+    { \
+        return MethodType; \
+    } \
+    virtual bool is(TSType* otherType) \
+    { \
+        return this == otherType || base()->is(otherType); \
+    } \
+    static CLASS##METHOD##Method##TypeClass* cast(TSType* otherType) \
+    { \
+        return otherType && otherType->is(&typeInstance) ? (CLASS##METHOD##Method##TypeClass *)otherType : NULL; \
+    } \
+protected: \
+    CLASS##METHOD##Method##TypeClass(const TSString& name, const TSString& description) : \
+        MethodTypeClass(name, description) \
+    { \
+        registerMethod(CLASS##Type, &Invoker::invoke); \
+    } \
+public: \
+    virtual TSType* returnType() \
+    { \
+        return Invoker::returnType(); \
+    } \
+    virtual int argumentCount() \
+    { \
+        return Invoker::argumentCount; \
+    } \
+    virtual TSType* argumentType(int index) \
+    { \
+        return Invoker::argumentType(index); \
+    } \
+}; \
+CLASS##METHOD##MethodTypeClass CLASS##METHOD##MethodTypeClass::typeInstance(#CLASS #METHOD, #METHOD);
+
 
 
 
@@ -559,12 +1177,21 @@ public:
         newClass->referenced = NULL;
         return newClass;
     }
+    virtual void* clone(void* object)
+    {
+        return new GenericReference(*(GenericReference *)object);
+    }
     virtual int sizeOf()
     {
         return sizeof(GenericReference);
     }
+    virtual void destroy(void* object)
+    {
+        delete (GenericReference *)object;
+    }
 };
 extern GenericReferenceTypeClass* GenericReferenceType;
+TSDeclareTypeOf(GenericReference)
 
 TSDeclarePointerType(GenericReference);
 TSDeclarePointerType(GenericReferencePtr);
@@ -572,6 +1199,8 @@ TSDeclareTemplateTypes(GenericReference);
 TSDeclareTemplateTypes(GenericReferencePtr);
 TSDeclareAbstractType(TSType, TSEmpty);
 TSDeclareType(TSString, TSEmpty);
+TSDeclareDictionaryType(TSString);
+TSDeclareDequeType(TSString);
 
 void PrintObjectHierarchy(TSType* type, void* value, int maxLevelsDeep = 10, int levelsDeep = 0);
 
@@ -0,0 +1,215 @@
+#include "TSVersioned.h"
+
+/////////////////////////////////////////////////////////////////////////
+// Epochs announced by threads that hold snapshots
+/////////////////////////////////////////////////////////////////////////
+class TSEpochSlot
+{
+public:
+    // 0 while the thread holds no snapshot
+    std::atomic<unsigned long long> epoch;
+    std::atomic<bool> used;
+    TSEpochSlot* next;
+    int depth;
+    
+    TSEpochSlot() : epoch(0), used(true), next(NULL), depth(0)
+    {
+    }
+};
+
+static std::atomic<unsigned long long> GlobalEpoch(1);
+static std::atomic<TSEpochSlot *> EpochSlots(NULL);
+
+// Slots are never freed, a slot is reused once its thread exits
+static TSEpochSlot* AcquireEpochSlot()
+{
+    for(TSEpochSlot* slot = EpochSlots.load(); slot; slot = slot->next)
+    {
+        bool unused = false;
+        if(slot->used.compare_exchange_strong(unused, true))
+        {
+            return slot;
+        }
+    }
+    
+    TSEpochSlot* slot = new TSEpochSlot();
+    slot->next = EpochSlots.load();
+    while(!EpochSlots.compare_exchange_weak(slot->next, slot))
+    {
+    }
+    
+    return slot;
+}
+
+class TSThreadEpoch
+{
+public:
+    TSEpochSlot* slot;
+    
+    TSThreadEpoch() : slot(AcquireEpochSlot())
+    {
+    }
+    
+    ~TSThreadEpoch()
+    {
+        slot->epoch.store(0);
+        slot->used.store(false);
+    }
+};
+
+static TSEpochSlot* ThreadEpochSlot()
+{
+    static thread_local TSThreadEpoch threadEpoch;
+    return threadEpoch.slot;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// TSVersioned
+/////////////////////////////////////////////////////////////////////////
+TSVersioned::TSVersioned(TSType* type, void* value) : type(type), current(value)
+{
+}
+
+TSVersioned::~TSVersioned()
+{
+    for(size_t i = 0; i < retired.size(); i++)
+    {
+        destroy(retired[i].value);
+    }
+    
+    destroy(current.load());
+}
+
+TSVersioned::Snapshot::Snapshot(TSVersioned& versioned)
+{
+    TSEpochSlot* slot = ThreadEpochSlot();
+    
+    // The epoch is announced before the pointer is read, so a writer that
+    // retires this version afterwards sees the announcement
+    if(slot->depth++ == 0)
+    {
+        slot->epoch.store(GlobalEpoch.load());
+    }
+    
+    value = versioned.current.load();
+}
+
+TSVersioned::Snapshot::~Snapshot()
+{
+    TSEpochSlot* slot = ThreadEpochSlot();
+    
+    if(--slot->depth == 0)
+    {
+        slot->epoch.store(0);
+    }
+}
+
+void* TSVersioned::clone()
+{
+    Snapshot snapshot(*this);
+    void* value = snapshot.get();
+    
+    TSObject* object = type->is(TSObjectType) ? TSObjectType->cast(value) : NULL;
+    void* copy = object ? object->type->clone(value) : type->clone(value);
+    
+    assert(copy && "The versioned type has no copy constructor to clone with\n");
+    return copy;
+}
+
+void TSVersioned::publish(void* value)
+{
+    {
+        // Keeps both versions alive while subscribers look at them, a version
+        // retired after this epoch was announced isn't freed until it ends
+        Snapshot pin(*this);
+        
+        void* oldValue;
+        TSArray<Subscription> changed;
+        {
+            std::lock_guard<std::mutex> lock(writeLock);
+            
+            oldValue = current.exchange(value);
+            
+            // Readers that announced this epoch or an earlier one may hold oldValue
+            Retired oldVersion;
+            oldVersion.value = oldValue;
+            oldVersion.epoch = GlobalEpoch.fetch_add(1);
+            retired.push_back(oldVersion);
+            
+            size_t size = subscriptions.size();
+            for(size_t i = 0; i < size; i++)
+            {
+                if(!subscriptions[i].field->equalValues(oldValue, value))
+                {
+                    changed.push_back(subscriptions[i]);
+                }
+            }
+        }
+        
+        // Unlocked so subscribers can publish, subscribe or reclaim
+        size_t size = changed.size();
+        for(size_t i = 0; i < size; i++)
+        {
+            const Subscription& subscription = changed[i];
+            subscription.function(subscription.field, subscription.field->get(oldValue), subscription.field->get(value), subscription.context);
+        }
+    }
+    
+    reclaim();
+}
+
+void TSVersioned::subscribe(TSType* field, ChangeFunction function, void* context)
+{
+    std::lock_guard<std::mutex> lock(writeLock);
+    
+    Subscription subscription;
+    subscription.field = field;
+    subscription.function = function;
+    subscription.context = context;
+    subscriptions.push_back(subscription);
+}
+
+void TSVersioned::reclaim()
+{
+    std::lock_guard<std::mutex> lock(writeLock);
+    destroyUnreachable();
+}
+
+void TSVersioned::destroyUnreachable()
+{
+    unsigned long long oldestEpoch = ~0ULL;
+    for(TSEpochSlot* slot = EpochSlots.load(); slot; slot = slot->next)
+    {
+        unsigned long long epoch = slot->epoch.load();
+        if(epoch && epoch < oldestEpoch) oldestEpoch = epoch;
+    }
+    
+    size_t kept = 0;
+    for(size_t i = 0; i < retired.size(); i++)
+    {
+        if(retired[i].epoch < oldestEpoch)
+        {
+            destroy(retired[i].value);
+        }
+        else
+        {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+}
+
+void TSVersioned::destroy(void* value)
+{
+    if(!value) return;
+    
+    TSObject* object = type->is(TSObjectType) ? TSObjectType->cast(value) : NULL;
+    if(object)
+    {
+        object->destroy();
+    }
+    else
+    {
+        type->destroy(value);
+    }
+}
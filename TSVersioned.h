@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////////////
+// TSVersioned
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TSVersioned_h
+#define TSVersioned_h
+
+#include "TSType.h"
+#include <atomic>
+#include <mutex>
+
+/////////////////////////////////////////////////////////////////////////
+// Holds the current version of a reflected object. Readers never block,
+// writers publish a whole new version and old versions are freed once
+// no reader can still see them.
+/////////////////////////////////////////////////////////////////////////
+class TSVersioned
+{
+public:
+    typedef void (*ChangeFunction)(TSType* field, void* oldValue, void* newValue, void* context);
+    
+    // Takes ownership of value
+    TSVersioned(TSType* type, void* value);
+    
+    // No snapshot may outlive the holder
+    ~TSVersioned();
+    
+    // Keeps the version that was current when it was taken alive
+    class Snapshot
+    {
+    public:
+        Snapshot(TSVersioned& versioned);
+        ~Snapshot();
+        
+        void* get()
+        {
+            return value;
+        }
+    
+    private:
+        Snapshot(const Snapshot&);
+        Snapshot& operator=(const Snapshot&);
+        
+        void* value;
+    };
+    
+    // Copy of the current version for a writer to edit, made with the
+    // type's copy constructor. It's shallow: objects it points to are
+    // shared with the current version. Asserts and returns NULL for types
+    // that can't be copied, build and publish a new value for those.
+    void* clone();
+    
+    // Makes value the current version and takes ownership of it, then
+    // notifies subscribers of fields that differ from the old version.
+    // Subscribers are called without the write lock, so they may publish
+    // themselves, and concurrent publishes may notify out of order.
+    void publish(void* value);
+    
+    void subscribe(TSType* field, ChangeFunction function, void* context);
+    
+    // Frees old versions that no snapshot can see
+    void reclaim();
+
+private:
+    TSVersioned(const TSVersioned&);
+    TSVersioned& operator=(const TSVersioned&);
+    
+    class Retired
+    {
+    public:
+        void* value;
+        unsigned long long epoch;
+    };
+    
+    class Subscription
+    {
+    public:
+        TSType* field;
+        ChangeFunction function;
+        void* context;
+    };
+    
+    void destroyUnreachable();
+    void destroy(void* value);
+    
+    TSType* type;
+    std::atomic<void *> current;
+    
+    // Writers only
+    std::mutex writeLock;
+    TSArray<Retired> retired;
+    TSArray<Subscription> subscriptions;
+};
+
+#endif
@@ -0,0 +1,67 @@
+// Compares a direct virtual call with TSMethod dispatch by id.
+//
+//     c++ -std=c++11 -O2 -I.. -include cassert -include cstring -include cstdio TSMethodBenchmark.cpp ../TSType.cpp -o TSMethodBenchmark
+
+#include "TSType.h"
+#include <chrono>
+
+class Counter : public TSObject
+{
+public:
+    virtual int add(int amount)
+    {
+        return amount * 2;
+    }
+};
+TSDeclareType(Counter, TSObject);
+
+TSImplementType(Counter, "counter");
+TSMethod(Counter, add);
+
+static double NanosecondsPerCall(std::chrono::steady_clock::time_point start, long calls)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+int main()
+{
+    const long calls = 200000000;
+    
+    // volatile keeps the compiler from devirtualizing the direct call
+    Counter* volatile counter = CounterType->create();
+    volatile long sink = 0;
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(long i = 0; i < calls; i++)
+    {
+        sink += counter->add((int)i);
+    }
+    printf("virtual call      %.2f ns\n", NanosecondsPerCall(start, calls));
+    
+    MethodTypeClass* method = MethodType->cast(CounterType->getMethodByName("Counteradd"));
+    start = std::chrono::steady_clock::now();
+    for(long i = 0; i < calls; i++)
+    {
+        int amount = (int)i;
+        int result;
+        void* arguments[] = { &amount };
+        method->invoke(counter, arguments, &result);
+        sink += result;
+    }
+    printf("invoke            %.2f ns\n", NanosecondsPerCall(start, calls));
+    
+    int id = CounterType->getMethodIdByName("Counteradd");
+    start = std::chrono::steady_clock::now();
+    for(long i = 0; i < calls; i++)
+    {
+        int amount = (int)i;
+        int result;
+        void* arguments[] = { &amount };
+        MethodTypeClass::invokeById(id, counter, arguments, &result);
+        sink += result;
+    }
+    printf("invokeById        %.2f ns\n", NanosecondsPerCall(start, calls));
+    
+    counter->destroy();
+    return 0;
+}